@@ -1,9 +1,16 @@
 #include <map>
+#include <array>
 #include <vector>
+#include <string>
 #include <numeric>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
 
 enum class choice { rock, paper, scissors };
 
@@ -42,8 +49,22 @@ const choice opponents_choice(const char a) {
     }
 }
 
+const int my_move_index(const char a) {
+    if (a < 'X' || a > 'Z')
+        throw std::invalid_argument("Invalid move");
+
+    return a - 'X';
+}
+
+using mixed_choice = std::map<choice, double>;
+
 struct Strategy {
     virtual choice move(const choice other, const char my_move) const = 0;
+
+    // probability of playing each choice; pure strategies play one choice with certainty
+    virtual mixed_choice mixed_move(const choice other, const char my_move) const {
+        return {{move(other, my_move), 1.0}};
+    }
 };
 
 struct FixedChoiceStrategy: public Strategy {
@@ -70,6 +91,59 @@ struct FixedOutcomeStrategy: public Strategy {
     }
 };
 
+struct TableStrategy: public Strategy {
+    // mixed strategy given as a table of probabilities over choices for each
+    // (opponent's choice, encrypted move) pair
+    using table = std::map<std::pair<choice, char>, mixed_choice>;
+    const table probabilities;
+
+    TableStrategy(const table &probabilities) : probabilities(probabilities) {
+        validate();
+    }
+
+    // same mix regardless of what the opponent plays
+    TableStrategy(const std::map<char, mixed_choice> &by_move) : probabilities(expand(by_move)) {
+        validate();
+    }
+
+    mixed_choice mixed_move(const choice other, const char my_move) const {
+        return probabilities.at({other, my_move});
+    }
+
+    choice move(const choice other, const char my_move) const {
+        auto mix = mixed_move(other, my_move);
+        return std::max_element(mix.begin(), mix.end(),
+                                [](auto &a, auto &b) { return a.second < b.second; })->first;
+    }
+
+    private:
+        // every mix must be a non-empty set of non-negative probabilities summing to 1
+        void validate() const {
+            for (auto &&[key, mix] : probabilities) {
+                if (mix.empty())
+                    throw std::invalid_argument("Empty mixed strategy");
+
+                double total = 0.0;
+                for (auto &&[c, p] : mix) {
+                    if (!(p >= 0.0))
+                        throw std::invalid_argument("Negative probability in mixed strategy");
+                    total += p;
+                }
+
+                if (std::abs(total - 1.0) > 1e-9)
+                    throw std::invalid_argument("Mixed strategy probabilities do not sum to 1");
+            }
+        }
+
+        static table expand(const std::map<char, mixed_choice> &by_move) {
+            table result;
+            for (auto other : {choice::rock, choice::paper, choice::scissors})
+                for (auto &&[my_move, mix] : by_move)
+                    result[{other, my_move}] = mix;
+            return result;
+        }
+};
+
 class RPS_move {
     public:
         const choice state;
@@ -123,6 +197,8 @@ class RPS_round {
         RPS_round(const char p1, const char p2, const Strategy *strategy) : 
             player1(opponents_choice(p1)), player2(player1, p2, strategy) {}
 
+        RPS_round(const choice p1, const choice p2) : player1(p1), player2(p2) {}
+
         const int win_bonus = 6;
         const int tie_bonus = 3;
 
@@ -156,6 +232,63 @@ class RPS_round {
         }
 };
 
+class StrategyEngine {
+    // scores any number of strategies against the same plays; the plays are
+    // scanned once into a table of counts for each of the nine possible
+    // (opponent, encrypted move) pairs, and each strategy is then scored
+    // against that table
+    private:
+        using play_counts = std::array<std::array<long, 3>, 3>;
+        std::vector<std::pair<std::string, const Strategy *>> strategies;
+
+        static play_counts count_plays(const std::vector<std::pair<char, char>> &plays) {
+            play_counts counts{};
+            std::for_each(plays.begin(), plays.end(), [&counts](auto &&play) {
+                counts[(int)opponents_choice(play.first)][my_move_index(play.second)]++;
+            });
+            return counts;
+        }
+
+        static double expected_score(const Strategy *strategy, const choice other, const char my_move) {
+            auto mix = strategy->mixed_move(other, my_move);
+            return std::accumulate(mix.begin(), mix.end(), 0.0, [other](double acc, auto &&p) {
+                return acc + p.second * RPS_round(other, p.first).player2_score();
+            });
+        }
+
+    public:
+        void add(const std::string &name, const Strategy *strategy) {
+            strategies.push_back(std::make_pair(name, strategy));
+        }
+
+        size_t size() const {
+            return strategies.size();
+        }
+
+        // total (expected) score of player 2 under each strategy, in the order added
+        std::vector<std::pair<std::string, double>> score(const std::vector<std::pair<char, char>> &plays) const {
+            const auto counts = count_plays(plays);
+            const std::array<choice, 3> others = {choice::rock, choice::paper, choice::scissors};
+            const std::array<char, 3> my_moves = {'X', 'Y', 'Z'};
+
+            std::vector<std::pair<std::string, double>> totals;
+            std::transform(strategies.begin(), strategies.end(), std::back_inserter(totals),
+                           [&](auto &&named_strategy) {
+                               auto &&[name, strategy] = named_strategy;
+                               double total = 0.0;
+                               for (auto other : others)
+                                   for (auto my_move : my_moves) {
+                                       auto count = counts[(int)other][my_move_index(my_move)];
+                                       if (count > 0)
+                                           total += count * expected_score(strategy, other, my_move);
+                                   }
+                               return std::make_pair(name, total);
+                           });
+
+            return totals;
+        }
+};
+
 std::vector<std::pair<char, char>> get_inputs(std::ifstream &input) {
     // read a list of list of integers from the input file,
     // with each list separated by a blank line
@@ -179,8 +312,8 @@ std::vector<std::pair<char, char>> get_inputs(std::ifstream &input) {
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    if (argc < 2 || argc > 3 || (argc == 3 && std::string(argv[2]) != "mixed")) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [mixed]" << std::endl;
         return 1;
     }
 
@@ -191,28 +324,24 @@ int main(int argc, char** argv) {
     }
 
     auto plays = get_inputs(input);
-    std::vector<RPS_round> rounds;
 
-    std::cout << "Part 1" << std::endl;
     FixedChoiceStrategy strategy1;
-    std::transform(plays.begin(), plays.end(), std::back_inserter(rounds),
-                   [&strategy1](auto play) { return RPS_round(play.first, play.second, &strategy1); });
-
-    auto p1_score = std::accumulate(rounds.begin(), rounds.end(), 0,
-                                    [](int acc, auto round) { return acc + round.player2_score(); });
-
-    std::cout << p1_score << std::endl;
-
-    std::cout << "Part 2" << std::endl;
-    rounds.clear();
     FixedOutcomeStrategy strategy2;
-    std::transform(plays.begin(), plays.end(), std::back_inserter(rounds),
-                   [&strategy2](auto play) { return RPS_round(play.first, play.second, &strategy2); });
 
-    auto p2_score = std::accumulate(rounds.begin(), rounds.end(), 0,
-                                    [](int acc, auto round) { return acc + round.player2_score(); });
+    StrategyEngine engine;
+    engine.add("Part 1", &strategy1);
+    engine.add("Part 2", &strategy2);
 
-    std::cout << p2_score << std::endl;
+    // expected score of playing each choice a third of the time, whatever the move
+    const mixed_choice uniform = {{choice::rock, 1.0/3}, {choice::paper, 1.0/3}, {choice::scissors, 1.0/3}};
+    TableStrategy strategy3({{'X', uniform}, {'Y', uniform}, {'Z', uniform}});
+    if (argc == 3)
+        engine.add("Uniform mixed strategy", &strategy3);
+
+    for (auto &&[name, total] : engine.score(plays)) {
+        std::cout << name << std::endl;
+        std::cout << std::llround(total) << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
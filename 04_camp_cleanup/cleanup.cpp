@@ -1,11 +1,15 @@
 #include <iostream>
 #include <string>
 #include <fstream>
-#include <sstream>
 #include <vector>
-#include "range/v3/all.hpp"
 #include <algorithm>
-#include <regex>
+#include <cctype>
+#include <stdexcept>
+#include <numeric>
+#include <iterator>
+#include <utility>
+#include <execution>
+#include <limits>
 
 
 class CleanupRange {
@@ -42,6 +46,9 @@ public:
     CleanupRange(int first, int last) : first(first), last(last) {}
     CleanupRange(std::pair<int, int> firstlast) : first(firstlast.first), last(firstlast.second) {}
 
+    int get_first() const { return first; }
+    int get_last() const { return last; }
+
     bool contains(int value) const {
         return value >= first && value <= last;
     }
@@ -59,37 +66,326 @@ public:
     }
 };
 
-namespace rv = ranges::views;
-
-std::vector<std::pair<CleanupRange, CleanupRange>> get_inputs(std::ifstream &input) {
-    std::vector<std::string> input_lines(std::istream_iterator<std::string>(input), {});
-
-    auto results = input_lines 
-                    | rv::transform([](const std::string &line) {
-                        std::regex regex{R"([\s,-]+)"};
-                        std::sregex_token_iterator it{line.begin(), line.end(), regex, -1};
-                        std::vector<std::string> items{it, {}};
-                        return items;
-                       })
-                    | rv::transform([](auto &&stringvec) {
-                        auto first = std::make_pair(std::stoi(stringvec[0]), std::stoi(stringvec[1]));
-                        auto second = std::make_pair(std::stoi(stringvec[2]), std::stoi(stringvec[3]));
-                        return std::make_pair(first, second);
-                      }) 
-                    | rv::transform([](auto &&pairs) {
-                        auto first = pairs.first;
-                        auto second = pairs.second;
-                        return std::make_pair(CleanupRange(first), CleanupRange(second));
-                      });
-
-    std::vector<std::pair<CleanupRange, CleanupRange>> output;
-    ranges::copy(results, std::back_inserter(output));
+class CleanupIndex {
+    // index over a whole file's worth of ranges for cross-assignment queries.
+    // Ranges are kept sorted by first section; over that order there is a
+    // segment tree of the largest last section (for reporting overlaps) and
+    // a merge-sort tree of sorted last sections (for counting containment).
+    std::vector<CleanupRange> ranges;
+    std::vector<size_t> ids;
+    std::vector<int> firsts;
+    std::vector<int> sorted_lasts;
+    std::vector<int> max_last;
+    std::vector<std::vector<int>> lasts_tree;
+
+    void build(size_t node, size_t lo, size_t hi) {
+        if (hi - lo == 1) {
+            max_last[node] = ranges[lo].get_last();
+            lasts_tree[node] = {ranges[lo].get_last()};
+            return;
+        }
+
+        const size_t mid = (lo + hi) / 2;
+        build(2*node, lo, mid);
+        build(2*node+1, mid, hi);
+
+        max_last[node] = std::max(max_last[2*node], max_last[2*node+1]);
+        std::merge(lasts_tree[2*node].begin(), lasts_tree[2*node].end(),
+                   lasts_tree[2*node+1].begin(), lasts_tree[2*node+1].end(),
+                   std::back_inserter(lasts_tree[node]));
+    }
+
+    // number of ranges at sorted positions [l, r) whose last section is >= value
+    size_t count_last_at_least(size_t node, size_t lo, size_t hi, size_t l, size_t r, int value) const {
+        if (r <= lo || hi <= l)
+            return 0;
+
+        if (l <= lo && hi <= r) {
+            auto &lasts = lasts_tree[node];
+            return lasts.end() - std::lower_bound(lasts.begin(), lasts.end(), value);
+        }
+
+        const size_t mid = (lo + hi) / 2;
+        return count_last_at_least(2*node, lo, mid, l, r, value)
+             + count_last_at_least(2*node+1, mid, hi, l, r, value);
+    }
+
+    // report ranges at sorted positions [0, r) whose last section is >= value,
+    // skipping any subtree whose largest last section is too small
+    void report_last_at_least(size_t node, size_t lo, size_t hi, size_t r, int value, std::vector<size_t> &result) const {
+        if (r <= lo || max_last[node] < value)
+            return;
+
+        if (hi - lo == 1) {
+            result.push_back(ids[lo]);
+            return;
+        }
+
+        const size_t mid = (lo + hi) / 2;
+        report_last_at_least(2*node, lo, mid, r, value, result);
+        report_last_at_least(2*node+1, mid, hi, r, value, result);
+    }
+
+public:
+    CleanupIndex(const std::vector<CleanupRange> &input) : ids(input.size()) {
+        std::iota(ids.begin(), ids.end(), 0);
+        std::sort(ids.begin(), ids.end(), [&input](size_t a, size_t b) {
+            return input[a].get_first() < input[b].get_first();
+        });
+
+        std::transform(ids.begin(), ids.end(), std::back_inserter(ranges), [&input](size_t i) { return input[i]; });
+        std::transform(ranges.begin(), ranges.end(), std::back_inserter(firsts), [](auto &r) { return r.get_first(); });
+        std::transform(ranges.begin(), ranges.end(), std::back_inserter(sorted_lasts), [](auto &r) { return r.get_last(); });
+        std::sort(sorted_lasts.begin(), sorted_lasts.end());
+
+        if (!ranges.empty()) {
+            max_last.resize(4 * ranges.size());
+            lasts_tree.resize(4 * ranges.size());
+            build(1, 0, ranges.size());
+        }
+    }
+
+    size_t size() const {
+        return ranges.size();
+    }
+
+    // number of assignments sharing at least one section with range;
+    // a range overlaps unless it starts after or ends before, and no range does both
+    size_t count_overlapping(const CleanupRange &range) const {
+        size_t starts_after = firsts.end() - std::upper_bound(firsts.begin(), firsts.end(), range.get_last());
+        size_t ends_before = std::lower_bound(sorted_lasts.begin(), sorted_lasts.end(), range.get_first()) - sorted_lasts.begin();
+        return size() - starts_after - ends_before;
+    }
+
+    // number of assignments that fully contain range
+    size_t count_containing(const CleanupRange &range) const {
+        size_t r = std::upper_bound(firsts.begin(), firsts.end(), range.get_first()) - firsts.begin();
+        return size() ? count_last_at_least(1, 0, size(), 0, r, range.get_last()) : 0;
+    }
+
+    // number of assignments fully contained by range
+    size_t count_contained_by(const CleanupRange &range) const {
+        size_t l = std::lower_bound(firsts.begin(), firsts.end(), range.get_first()) - firsts.begin();
+        size_t r = std::upper_bound(firsts.begin(), firsts.end(), range.get_last()) - firsts.begin();
+        if (!size() || l >= r)
+            return 0;
+        return (r - l) - count_last_at_least(1, 0, size(), l, r, range.get_last() + 1);
+    }
+
+    // input positions of every assignment overlapping range
+    std::vector<size_t> overlapping(const CleanupRange &range) const {
+        std::vector<size_t> result;
+        size_t r = std::upper_bound(firsts.begin(), firsts.end(), range.get_last()) - firsts.begin();
+        if (size())
+            report_last_at_least(1, 0, size(), r, range.get_first(), result);
+        return result;
+    }
+
+    // every pair of input positions (i < j) whose assignments overlap.  In first-section
+    // order, every later range that starts before this one ends overlaps it, so
+    // each step of the scan finds a pair.
+    std::vector<std::pair<size_t, size_t>> overlapping_pairs() const {
+        std::vector<std::pair<size_t, size_t>> result;
+        for (size_t i = 0; i < size(); i++) {
+            for (size_t j = i+1; j < size() && firsts[j] <= ranges[i].get_last(); j++) {
+                result.push_back(std::minmax(ids[i], ids[j]));
+            }
+        }
+        return result;
+    }
+};
+
+struct CleanupAssignments {
+    // the two ranges from each line, stored as four contiguous arrays of sections
+    std::vector<int> first1;
+    std::vector<int> last1;
+    std::vector<int> first2;
+    std::vector<int> last2;
+
+    size_t size() const {
+        return first1.size();
+    }
+
+    void reserve(size_t n) {
+        first1.reserve(n);
+        last1.reserve(n);
+        first2.reserve(n);
+        last2.reserve(n);
+    }
+
+    void push_back(const CleanupRange &range1, const CleanupRange &range2) {
+        first1.push_back(range1.get_first());
+        last1.push_back(range1.get_last());
+        first2.push_back(range2.get_first());
+        last2.push_back(range2.get_last());
+    }
+
+    CleanupRange range1(size_t i) const { return CleanupRange(first1[i], last1[i]); }
+    CleanupRange range2(size_t i) const { return CleanupRange(first2[i], last2[i]); }
+};
+
+struct CleanupCounts {
+    int fully_contained = 0;
+    int overlapping = 0;
+
+    friend CleanupCounts operator+(const CleanupCounts &a, const CleanupCounts &b) {
+        return {a.fully_contained + b.fully_contained, a.overlapping + b.overlapping};
+    }
+};
+
+// counts for n pairs starting at offset; comparisons are combined with & and |
+// rather than && and || so the loop has no branches and can be vectorized
+CleanupCounts count_block(const CleanupAssignments &a, const size_t offset, const size_t n) {
+    const int *f1 = a.first1.data() + offset, *l1 = a.last1.data() + offset;
+    const int *f2 = a.first2.data() + offset, *l2 = a.last2.data() + offset;
+
+    int fully_contained = 0, overlapping = 0;
+    for (size_t i = 0; i < n; i++) {
+        fully_contained += ((f1[i] <= f2[i]) & (l2[i] <= l1[i])) | ((f2[i] <= f1[i]) & (l1[i] <= l2[i]));
+        overlapping += (f1[i] <= l2[i]) & (f2[i] <= l1[i]);
+    }
+
+    return {fully_contained, overlapping};
+}
+
+// part 1 and part 2 counts in one pass, with blocks counted in parallel
+CleanupCounts count_assignments(const CleanupAssignments &assignments) {
+    static constexpr size_t block_size = 1 << 16;
+    const size_t n = assignments.size();
+
+    std::vector<size_t> offsets((n + block_size - 1) / block_size);
+    std::generate(offsets.begin(), offsets.end(), [offset = (size_t)0]() mutable {
+        auto result = offset;
+        offset += block_size;
+        return result;
+    });
+
+    return std::transform_reduce(std::execution::par_unseq, offsets.begin(), offsets.end(),
+                                 CleanupCounts{}, std::plus<CleanupCounts>(),
+                                 [&assignments, n](size_t offset) {
+                                     return count_block(assignments, offset, std::min(block_size, n - offset));
+                                 });
+}
+
+class CoverageProfile {
+    // number of assignments covering each section, built with a difference
+    // array: +1 where each range starts and -1 just past where it ends, then
+    // a prefix sum.  A second prefix sum answers range-sum queries in O(1).
+    int lowest = 0;
+    std::vector<long> depth;
+    std::vector<long> cumulative;
+
+    // a reversed range (first > last) covers no sections and is skipped
+    void add(std::vector<long> &diff, const std::vector<int> &firsts, const std::vector<int> &lasts) const {
+        for (size_t i = 0; i < firsts.size(); i++) {
+            if (firsts[i] > lasts[i])
+                continue;
+            diff[firsts[i] - lowest]++;
+            diff[lasts[i] - lowest + 1]--;
+        }
+    }
+
+public:
+    CoverageProfile(const CleanupAssignments &assignments) {
+        if (assignments.size() == 0)
+            return;
+
+        // bounds over all four arrays, so no range can fall outside them
+        lowest = assignments.first1[0];
+        int highest = lowest;
+        for (auto *sections : {&assignments.first1, &assignments.last1, &assignments.first2, &assignments.last2}) {
+            auto [lo, hi] = std::minmax_element(sections->begin(), sections->end());
+            lowest = std::min(lowest, *lo);
+            highest = std::max(highest, *hi);
+        }
+
+        std::vector<long> diff(highest - lowest + 2, 0);
+        add(diff, assignments.first1, assignments.last1);
+        add(diff, assignments.first2, assignments.last2);
+        diff.pop_back();
+
+        std::inclusive_scan(diff.begin(), diff.end(), std::back_inserter(depth));
+        std::inclusive_scan(depth.begin(), depth.end(), std::back_inserter(cumulative));
+    }
+
+    // number of assignments including section
+    long coverage(int section) const {
+        if (section < lowest || section - lowest >= (long)depth.size())
+            return 0;
+        return depth[section - lowest];
+    }
+
+    long max_coverage() const {
+        return depth.empty() ? 0 : *std::max_element(depth.begin(), depth.end());
+    }
+
+    // sum of coverage over every section of range
+    long total_coverage(const CleanupRange &range) const {
+        auto prefix = [this](long section) -> long {
+            // sum of coverage over sections below `section`
+            long i = std::min(section - lowest, (long)cumulative.size());
+            return i <= 0 ? 0 : cumulative[i - 1];
+        };
+        return prefix((long)range.get_last() + 1) - prefix(range.get_first());
+    }
+};
+
+CleanupAssignments get_inputs(std::ifstream &input) {
+    // reads "a-b,c-d" lines straight from the file's bytes
+    const std::string buffer(std::istreambuf_iterator<char>(input), {});
+    const char *p = buffer.data();
+    const char *const end = p + buffer.size();
+
+    auto read_int = [&p, end]() {
+        if (p == end || *p < '0' || *p > '9')
+            throw std::invalid_argument("Invalid input");
+
+        int value = 0;
+        while (p != end && *p >= '0' && *p <= '9') {
+            const int digit = *p++ - '0';
+            if (value > (std::numeric_limits<int>::max() - digit) / 10)
+                throw std::invalid_argument("Section number out of range");
+            value = value * 10 + digit;
+        }
+        return value;
+    };
+
+    auto expect = [&p, end](const char c) {
+        if (p == end || *p != c)
+            throw std::invalid_argument("Invalid input");
+        ++p;
+    };
+
+    CleanupAssignments output;
+    output.reserve(std::count(buffer.begin(), buffer.end(), '\n') + 1);
+
+    while (true) {
+        while (p != end && std::isspace((unsigned char)*p))
+            ++p;
+        if (p == end)
+            break;
+
+        const int first1 = read_int();
+        expect('-');
+        const int last1 = read_int();
+        expect(',');
+        const int first2 = read_int();
+        expect('-');
+        const int last2 = read_int();
+
+        if (first1 > last1 || first2 > last2)
+            throw std::invalid_argument("Range ends before it starts");
+
+        output.push_back(CleanupRange(first1, last1), CleanupRange(first2, last2));
+    }
+
     return output;
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    const std::string mode = argc == 3 ? argv[2] : "";
+    if (argc < 2 || argc > 3 || (argc == 3 && mode != "index" && mode != "coverage")) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [index|coverage]" << std::endl;
         return 1;
     }
 
@@ -100,27 +396,31 @@ int main(int argc, char** argv) {
     }
 
     auto inputs = get_inputs(input);
-    int n_fully_contained = std::transform_reduce(inputs.begin(), inputs.end(), 
-                                                  0, std::plus<int>(),
-                                                  [](const auto &pair) {
-                                                    auto range1 = pair.first;
-                                                    auto range2 = pair.second;
-                                                    return (range1.contains(range2) || range2.contains(range1)) ? 1 : 0;
-                                                  });
+    auto counts = count_assignments(inputs);
 
     std::cout << "Part 1" << std::endl;
-    std::cout << n_fully_contained << std::endl;
-
-    int n_overlaps = std::transform_reduce(inputs.begin(), inputs.end(), 
-                                           0, std::plus<int>(),
-                                           [](const auto &pair) {
-                                              auto range1 = pair.first;
-                                              auto range2 = pair.second;
-                                              return range1.overlaps(range2) ? 1 : 0;
-                                            });
+    std::cout << counts.fully_contained << std::endl;
 
     std::cout << "Part 2" << std::endl;
-    std::cout << n_overlaps << std::endl;
+    std::cout << counts.overlapping << std::endl;
+
+    if (mode == "index") {
+        std::vector<CleanupRange> all_ranges;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            all_ranges.push_back(inputs.range1(i));
+            all_ranges.push_back(inputs.range2(i));
+        }
+
+        CleanupIndex index(all_ranges);
+        std::cout << "Overlapping pairs of assignments" << std::endl;
+        std::cout << index.overlapping_pairs().size() << std::endl;
+    }
+
+    if (mode == "coverage") {
+        CoverageProfile profile(inputs);
+        std::cout << "Maximum coverage" << std::endl;
+        std::cout << profile.max_coverage() << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
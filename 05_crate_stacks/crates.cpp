@@ -2,9 +2,14 @@
 #include <fstream>
 #include <vector>
 #include <tuple>
-#include <deque>
 #include <numeric>
 #include <cassert>
+#include <algorithm>
+#include <memory>
+#include <iterator>
+#include <random>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include "range/v3/all.hpp"
 
@@ -13,17 +18,20 @@ using move = std::tuple<int, int, int>;
 
 class CrateStacks {
 private:
+    // each stack is a contiguous buffer, bottom crate first, so moving n
+    // crates is one block copy off the end of one buffer onto another
     int n_stacks;
-    std::vector<std::deque<char>> stacks;
+    std::vector<std::vector<char>> stacks;
+
+    friend class CrateReplay;
+    friend class TreapStacks;
 
 public:
     CrateStacks(std::vector<std::vector<char>> inputs) : n_stacks(inputs.size()) {
         stacks = inputs | rv::transform([](auto &&vec) {
-                                           std::deque<char> stack;
-                                           ranges::copy(vec, std::front_inserter(stack));
-                                           return stack;
+                                           return std::vector<char>(vec.rbegin(), vec.rend());
                                         })
-                        | ranges::to<std::vector<std::deque<char>>>;
+                        | ranges::to<std::vector<std::vector<char>>>;
     }
 
     int get_n_stacks() const {
@@ -69,93 +77,382 @@ public:
         assert(from > 0 && from <= n_stacks);
         assert(to > 0 && to <= n_stacks);
 
-        const int zero_indexed_from = from-1;
-        const int zero_indexed_to = to-1;
-        assert(n <= stacks[zero_indexed_from].size());
+        auto &from_stack = stacks[from-1];
+        auto &to_stack = stacks[to-1];
+        assert((size_t)n <= from_stack.size());
+
+        // either way, moving crates onto the stack they came from changes nothing
+        if (from == to)
+            return;
+
+        move_block(n, from_stack, to_stack, all_at_once);
+    }
 
+    // one at a time reverses the moved block; all at once keeps its order
+    static void move_block(const int n, std::vector<char> &from_stack, std::vector<char> &to_stack, bool all_at_once) {
         if (!all_at_once) {
-            for (int i = 0; i < n; ++i) {
-                stacks[zero_indexed_to].push_back(stacks[zero_indexed_from].back());
-                stacks[zero_indexed_from].pop_back();
-            }
+            to_stack.insert(to_stack.end(), from_stack.rbegin(), from_stack.rbegin() + n);
         } else {
-            std::deque<char> temp;
-            for (int i = 0; i < n; ++i) {
-                temp.push_back(stacks[zero_indexed_from].back());
-                stacks[zero_indexed_from].pop_back();
+            to_stack.insert(to_stack.end(), from_stack.end() - n, from_stack.end());
+        }
+        from_stack.resize(from_stack.size() - n);
+    }
+
+    std::string top() const {
+        return stacks | rv::transform([](const auto &stack) { return stack.empty() ? ' ' : stack.back(); }) 
+                      | ranges::to<std::string>;
+    }
+
+    // top of each stack after the moves, without performing them.  Working
+    // backwards from the end, each final top position is traced to where its
+    // crate started, so the cost is O(moves x stacks) however many crates move.
+    std::string top_after(const std::vector<::move> &moves, bool all_at_once = false) const {
+        // final heights, to know which stacks end up empty
+        std::vector<size_t> heights(n_stacks);
+        std::transform(stacks.begin(), stacks.end(), heights.begin(), [](const auto &stack) { return stack.size(); });
+        for (const auto &[n, from, to] : moves) {
+            assert((size_t)n <= heights[from-1]);
+            heights[from-1] -= n;
+            heights[to-1] += n;
+        }
+
+        // (stack, depth below the top) of each final top crate
+        std::vector<std::pair<int, size_t>> positions(n_stacks);
+        for (int i = 0; i < n_stacks; i++)
+            positions[i] = std::make_pair(i, (size_t)0);
+
+        std::for_each(moves.rbegin(), moves.rend(), [&positions, all_at_once](const auto &m) {
+            const auto &[n, from, to] = m;
+            if (from == to)
+                return;
+
+            for (auto &[stack, depth] : positions) {
+                if (stack == to-1) {
+                    if (depth < (size_t)n) {
+                        stack = from-1;
+                        depth = all_at_once ? depth : n-1 - depth;
+                    } else {
+                        depth -= n;
+                    }
+                } else if (stack == from-1) {
+                    depth += n;
+                }
             }
-            for (int i = 0; i < n; ++i) {
-                stacks[zero_indexed_to].push_back(temp.back());
-                temp.pop_back();
+        });
+
+        std::string result(n_stacks, ' ');
+        for (int i = 0; i < n_stacks; i++) {
+            const auto &[stack, depth] = positions[i];
+            if (heights[i] > 0)
+                result[i] = stacks[stack][stacks[stack].size()-1 - depth];
+        }
+        return result;
+    }
+};
+
+
+class TreapStacks {
+    // stacks as implicit treaps (ordered bottom to top), so that taking the
+    // top n crates off one stack and putting them on another is a split and
+    // a merge, O(log n) however many crates move.  The one-at-a-time crane
+    // reverses the moved block, which is recorded as a lazy flag on its root.
+    // Nodes live in one arena and refer to each other by index.
+private:
+    struct Node {
+        char crate;
+        std::uint32_t priority;
+        int left = -1;
+        int right = -1;
+        size_t size = 1;
+        bool reversed = false;
+    };
+
+    int n_stacks;
+    std::vector<Node> nodes;
+    std::vector<int> roots;
+    std::mt19937 rng;
+
+    size_t size(int t) const {
+        return t < 0 ? 0 : nodes[t].size;
+    }
+
+    void push(int t) {
+        auto &node = nodes[t];
+        if (!node.reversed)
+            return;
+
+        std::swap(node.left, node.right);
+        if (node.left >= 0) nodes[node.left].reversed ^= true;
+        if (node.right >= 0) nodes[node.right].reversed ^= true;
+        node.reversed = false;
+    }
+
+    void update(int t) {
+        nodes[t].size = 1 + size(nodes[t].left) + size(nodes[t].right);
+    }
+
+    // first k crates of t (from the bottom), and the rest
+    std::pair<int, int> split(int t, size_t k) {
+        if (t < 0)
+            return {-1, -1};
+
+        push(t);
+        if (size(nodes[t].left) >= k) {
+            auto [first, rest] = split(nodes[t].left, k);
+            nodes[t].left = rest;
+            update(t);
+            return {first, t};
+        } else {
+            auto [first, rest] = split(nodes[t].right, k - size(nodes[t].left) - 1);
+            nodes[t].right = first;
+            update(t);
+            return {t, rest};
+        }
+    }
+
+    // a stacked on top of b
+    int merge(int b, int a) {
+        if (b < 0) return a;
+        if (a < 0) return b;
+
+        if (nodes[b].priority > nodes[a].priority) {
+            push(b);
+            nodes[b].right = merge(nodes[b].right, a);
+            update(b);
+            return b;
+        } else {
+            push(a);
+            nodes[a].left = merge(b, nodes[a].left);
+            update(a);
+            return a;
+        }
+    }
+
+public:
+    TreapStacks(const CrateStacks &cratestacks) : n_stacks(cratestacks.n_stacks), roots(n_stacks, -1) {
+        for (int i = 0; i < n_stacks; i++) {
+            for (const char crate : cratestacks.stacks[i]) {
+                nodes.push_back(Node{crate, (std::uint32_t)rng()});
+                roots[i] = merge(roots[i], nodes.size()-1);
             }
         }
     }
 
+    int get_n_stacks() const {
+        return n_stacks;
+    }
+
+    void move(const int n, const int from, const int to, bool all_at_once = false) {
+        assert(from > 0 && from <= n_stacks);
+        assert(to > 0 && to <= n_stacks);
+        assert((size_t)n <= size(roots[from-1]));
+
+        if (from == to)
+            return;
+
+        auto [rest, block] = split(roots[from-1], size(roots[from-1]) - n);
+        if (!all_at_once && block >= 0)
+            nodes[block].reversed ^= true;
+
+        roots[from-1] = rest;
+        roots[to-1] = merge(roots[to-1], block);
+    }
+
     std::string top() const {
-        return stacks | rv::transform([](const auto &stack) { return stack.back(); }) 
-                      | ranges::to<std::string>;
+        std::string result(n_stacks, ' ');
+        for (int i = 0; i < n_stacks; i++) {
+            // follow the rightmost path, tracking pending reversals instead of applying them
+            bool reversed = false;
+            for (int t = roots[i]; t >= 0; ) {
+                reversed ^= nodes[t].reversed;
+                int next = reversed ? nodes[t].left : nodes[t].right;
+                if (next < 0)
+                    result[i] = nodes[t].crate;
+                t = next;
+            }
+        }
+        return result;
     }
 };
 
+class CrateReplay {
+    // the stacks after any number of moves, from checkpoints taken every
+    // `interval` moves during one full replay.  A stack untouched since the
+    // previous checkpoint shares that checkpoint's copy; a stack touched by
+    // any move in an interval is copied whole, so with many moves per
+    // interval most checkpoints copy most stacks.
+private:
+    using snapshot = std::vector<std::shared_ptr<const std::vector<char>>>;
 
-std::pair<CrateStacks, std::vector<move>> get_inputs(std::ifstream &input) {
-    std::vector<std::string> input_lines;
-    std::string line;
+public:
+    class Stacks {
+        // stacks shared with a checkpoint; a stack is only copied when a
+        // replayed move touches it
+    private:
+        snapshot shared;
+        std::vector<std::unique_ptr<std::vector<char>>> copies;
 
-    while (std::getline(input, line)) {
-        input_lines.push_back(line);
-    }
-
-    auto items = input_lines  
-                 | rv::take_while([](const std::string &s) { return !s.empty(); })
-                 | rv::transform([](const std::string &s) { return " " + s; })
-                 | rv::transform([](const std::string &line) {
-                                    std::vector<std::pair<int, std::string>> items;
-                                    for (int i=0; i<line.length(); i+=4) {
-                                        items.push_back(std::make_pair(i/4, line.substr(i, 4)));
-                                    }
-                                    return items;
-                                 })
-                 | rv::filter([](const auto &v) { return !v.empty(); })
-                 | rv::join
-                 | rv::filter([](const auto &p) { return std::get<1>(p) != "    "; })
-                 | rv::filter([](const auto &p) { return std::get<1>(p)[1] == '['; })
-                 | rv::transform([](const auto &p) { return std::make_pair(std::get<0>(p), std::get<1>(p)[2]); })
-                 | ranges::to<std::vector<std::pair<int, char>>>;
-
-    int n_stacks = std::accumulate(items.begin(), items.end(), 0, [](int curmax, const auto &p) {
-        return std::max(curmax, std::get<0>(p) + 1);
-    });
-
-    std::vector<std::vector<char>> inputs(n_stacks);
-    for (const auto &p : items ) {
-        int index = std::get<0>(p);
-        char c = std::get<1>(p);
-        inputs[index].push_back(c);
-    }
-
-    CrateStacks cratestacks(inputs);
-
-    auto moves = input_lines 
-               | rv::drop_while([](const auto &s) { return !s.empty(); })
-               | rv::drop(1)
-               | rv::transform([](const auto &line) {
-                                    std::regex regex{R"(\d+)"};
-                                    std::sregex_iterator it(line.begin(), line.end(), regex);
-                                    std::vector<std::string> result;
-                                    for (auto &i = it; i != std::sregex_iterator(); ++i) {
-                                        result.push_back(i->str());
-                                    }
-                                    return std::make_tuple(std::stoi(result[0]), std::stoi(result[1]), std::stoi(result[2]));
-                               })
-               | ranges::to<std::vector<std::tuple<int, int, int>>>;
-
-    return std::make_pair(cratestacks, moves);
+        std::vector<char> &own(int i) {
+            if (!copies[i])
+                copies[i] = std::make_unique<std::vector<char>>(*shared[i]);
+            return *copies[i];
+        }
+
+    public:
+        Stacks(const snapshot &shared) : shared(shared), copies(shared.size()) {}
+
+        int get_n_stacks() const {
+            return shared.size();
+        }
+
+        const std::vector<char> &stack(int i) const {
+            return copies[i] ? *copies[i] : *shared[i];
+        }
+
+        void move(const int n, const int from, const int to, bool all_at_once) {
+            assert(from > 0 && from <= get_n_stacks());
+            assert(to > 0 && to <= get_n_stacks());
+            assert((size_t)n <= stack(from-1).size());
+
+            if (from == to)
+                return;
+
+            CrateStacks::move_block(n, own(from-1), own(to-1), all_at_once);
+        }
+
+        std::string top() const {
+            std::string result(get_n_stacks(), ' ');
+            for (int i = 0; i < get_n_stacks(); i++) {
+                if (!stack(i).empty())
+                    result[i] = stack(i).back();
+            }
+            return result;
+        }
+    };
+
+private:
+
+    std::vector<move> moves;
+    bool all_at_once;
+    size_t interval;
+    std::vector<snapshot> checkpoints;
+
+public:
+    CrateReplay(const CrateStacks &initial, const std::vector<move> &moves,
+                bool all_at_once = false, size_t interval = 1024)
+        : moves(moves), all_at_once(all_at_once), interval(std::max(interval, (size_t)1)) {
+
+        CrateStacks current = initial;
+        snapshot last;
+        std::transform(current.stacks.begin(), current.stacks.end(), std::back_inserter(last),
+                       [](const auto &stack) { return std::make_shared<const std::vector<char>>(stack); });
+        checkpoints.push_back(last);
+
+        std::vector<bool> changed(current.n_stacks, false);
+        for (size_t i = 0; i < moves.size(); i++) {
+            const auto &[n, from, to] = moves[i];
+            current.move(n, from, to, all_at_once);
+            changed[from-1] = changed[to-1] = true;
+
+            if ((i+1) % this->interval == 0) {
+                for (int j = 0; j < current.n_stacks; j++) {
+                    if (changed[j])
+                        last[j] = std::make_shared<const std::vector<char>>(current.stacks[j]);
+                }
+                checkpoints.push_back(last);
+                std::fill(changed.begin(), changed.end(), false);
+            }
+        }
+    }
+
+    size_t size() const {
+        return moves.size();
+    }
+
+    // stacks after the first k moves; replays at most interval-1 moves,
+    // copying only the stacks those moves touch
+    Stacks after(size_t k) const {
+        assert(k <= moves.size());
+
+        const size_t checkpoint = k / interval;
+        Stacks result(checkpoints[checkpoint]);
+
+        for (size_t i = checkpoint * interval; i < k; i++) {
+            const auto &[n, from, to] = moves[i];
+            result.move(n, from, to, all_at_once);
+        }
+        return result;
+    }
 };
 
+CrateStacks get_crate_stacks(std::istream &input) {
+    // reads the diagram up to its blank line; crate labels are at byte
+    // offsets 1, 5, 9, ... of each line, top crate first
+    std::vector<std::vector<char>> inputs;
+    std::string line;
+
+    while (std::getline(input, line) && !line.empty()) {
+        const size_t n_columns = (line.length() + 1) / 4;
+        if (inputs.size() < n_columns)
+            inputs.resize(n_columns);
+
+        for (size_t i = 0; i < n_columns; i++) {
+            if (line[4*i] == '[')
+                inputs[i].push_back(line[4*i + 1]);
+        }
+    }
+
+    return CrateStacks(inputs);
+}
+
+// reads the next "move a from b to c" line, skipping blank lines;
+// false at end of input
+bool read_move(std::istream &input, move &result) {
+    std::string line;
+    while (std::getline(input, line) && line.empty())
+        ;
+    if (line.empty())
+        return false;
+
+    const char *p = line.c_str();
+    auto expect = [&p](const char *word) {
+        for (; *word; word++, p++)
+            if (*p != *word)
+                throw std::invalid_argument("Invalid move");
+    };
+    auto read_int = [&p]() {
+        if (*p < '0' || *p > '9')
+            throw std::invalid_argument("Invalid move");
+        int value = 0;
+        while (*p >= '0' && *p <= '9')
+            value = value * 10 + (*p++ - '0');
+        return value;
+    };
+
+    expect("move ");
+    const int n = read_int();
+    expect(" from ");
+    const int from = read_int();
+    expect(" to ");
+    const int to = read_int();
+
+    result = std::make_tuple(n, from, to);
+    return true;
+}
+
+std::vector<move> get_moves(std::istream &input) {
+    std::vector<move> moves;
+    move m;
+    while (read_move(input, m))
+        moves.push_back(m);
+    return moves;
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    const std::string mode = argc > 2 ? argv[2] : "";
+    if (argc < 2 || ((mode == "lazy" || mode == "treap") && argc != 3) ||
+        (mode != "" && mode != "lazy" && mode != "treap" && mode != "after")) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [lazy | treap | after <n_moves>...]" << std::endl;
         return 1;
     }
 
@@ -165,24 +462,75 @@ int main(int argc, char** argv) {
         return 2;
     }
 
-    auto inputs = get_inputs(input);
-    auto p1stacks = inputs.first;
-    auto p2stacks = inputs.first;
-    auto moves = inputs.second;
+    auto cratestacks = get_crate_stacks(input);
+
+    if (mode == "") {
+        // apply each move as it is read
+        auto p1stacks = cratestacks;
+        auto p2stacks = cratestacks;
+
+        move m;
+        while (read_move(input, m)) {
+            const auto &[n, from, to] = m;
+            p1stacks.move(n, from, to);
+            p2stacks.move(n, from, to, true);
+        }
+
+        std::cout << "Part 1" << std::endl;
+        std::cout << p1stacks.top() << std::endl;
 
-    for (const auto move: moves) {
-        p1stacks.move(std::get<0>(move), std::get<1>(move), std::get<2>(move));
+        std::cout << "Part 2" << std::endl;
+        std::cout << p2stacks.top() << std::endl;
+
+        return 0;
     }
 
-    std::cout << "Part 1" << std::endl;
-    std::cout << p1stacks.top() << std::endl;
+    const auto moves = get_moves(input);
+
+    if (mode == "after") {
+        CrateReplay p1replay(cratestacks, moves);
+        CrateReplay p2replay(cratestacks, moves, true);
+
+        for (int i = 3; i < argc; i++) {
+            const size_t k = std::stoul(argv[i]);
+            if (k > p1replay.size()) {
+                std::cerr << "Only " << p1replay.size() << " moves" << std::endl;
+                return 1;
+            }
+
+            std::cout << "After " << k << " moves" << std::endl;
+            std::cout << p1replay.after(k).top() << std::endl;
+            std::cout << p2replay.after(k).top() << std::endl;
+        }
 
-    for (const auto move: moves) {
-        p2stacks.move(std::get<0>(move), std::get<1>(move), std::get<2>(move), true);
+        return 0;
     }
 
-    std::cout << "Part 2" << std::endl;
-    std::cout << p2stacks.top() << std::endl;
+    if (mode == "treap") {
+        TreapStacks p1stacks(cratestacks);
+        TreapStacks p2stacks(cratestacks);
+
+        for (const auto &[n, from, to] : moves) {
+            p1stacks.move(n, from, to);
+            p2stacks.move(n, from, to, true);
+        }
+
+        std::cout << "Part 1" << std::endl;
+        std::cout << p1stacks.top() << std::endl;
+
+        std::cout << "Part 2" << std::endl;
+        std::cout << p2stacks.top() << std::endl;
+
+        return 0;
+    }
+
+    if (mode == "lazy") {
+        std::cout << "Part 1" << std::endl;
+        std::cout << cratestacks.top_after(moves) << std::endl;
+
+        std::cout << "Part 2" << std::endl;
+        std::cout << cratestacks.top_after(moves, true) << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
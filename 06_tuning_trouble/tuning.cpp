@@ -1,55 +1,230 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <set>
+#include <string>
+#include <array>
 #include <algorithm>
-#include <iterator>
-#include "range/v3/all.hpp"
-
-namespace rv = ranges::views;
-
-int marker_start(std::string datapacket, int n) {
-    auto process = datapacket 
-                 | rv::sliding(n)
-                 | rv::enumerate
-                 | rv::transform([](auto &&t) {
-                                    auto &&[i, window] = t;
-                                    auto strset = std::set<char>(window.begin(), window.end());
-                                    bool all_unique = strset.size() == window.size();
-                                    std::string window_str(window.begin(), window.end());
-                                    return std::make_tuple(i, all_unique, window_str);
-                                 })
-                 | ranges::to<std::vector<std::tuple<size_t, bool, std::string>>>;
-
-    // TODO: can't figure out how to this lazily with ranges v3 + MacOS clang
-
-    auto results = std::find_if(std::begin(process), std::end(process),
-                                [](auto &&t) {
-                                   auto &&[i, all_unique, window] = t;
-                                   return all_unique;
-                                 });
-
-    auto &&[i, all_unique, window] = *results;
-    return i + n;
+#include <numeric>
+#include <execution>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <optional>
+
+// Shared state for any number of window sizes: the last position of each
+// byte value gives the length of the run of all-different characters ending
+// at the current position, and a window of size n ending here is a marker
+// exactly when that run is at least n long.
+class DistinctRun {
+    std::array<size_t, 256> last_seen{};   // position + 1 of last occurrence, 0 if none
+    size_t run_start = 0;
+    size_t position = 0;
+
+public:
+    // length of the run of distinct characters ending with c
+    size_t push(const unsigned char c) {
+        run_start = std::max(run_start, last_seen[c]);
+        last_seen[c] = ++position;
+        return position - run_start;
+    }
+
+    size_t get_position() const {
+        return position;
+    }
+};
+
+// position just after the first marker of each window size (in the order
+// given), or nothing where there is none; one scan serves every size, and it
+// stops once every size has been found
+std::vector<std::optional<size_t>> marker_starts(const std::string &datapacket, const std::vector<int> &window_sizes) {
+    if (std::any_of(window_sizes.begin(), window_sizes.end(), [](int n) { return n <= 0; }))
+        throw std::invalid_argument("Window sizes must be positive");
+
+    std::vector<size_t> order(window_sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&window_sizes](size_t a, size_t b) { return window_sizes[a] < window_sizes[b]; });
+
+    std::vector<std::optional<size_t>> result(window_sizes.size());
+    DistinctRun run;
+    size_t next = 0;
+
+    for (size_t i = 0; i < datapacket.size() && next < order.size(); i++) {
+        const size_t length = run.push(datapacket[i]);
+
+        // a longer run than a smaller window needs always comes no earlier
+        while (next < order.size() && (size_t)window_sizes[order[next]] <= length)
+            result[order[next++]] = i + 1;
+    }
+
+    return result;
+}
+
+std::optional<size_t> marker_start(const std::string &datapacket, int n) {
+    return marker_starts(datapacket, {n})[0];
+}
+
+// first window start in [first, last) whose n characters are all different,
+// or last if there is none.  Small windows are tested a block of positions at
+// a time by comparing every pair of offsets in the window; each comparison is
+// a contiguous byte loop the compiler vectorizes.  Larger windows, where the
+// number of pairs grows too quickly, use a DistinctRun scan.  The search is
+// abandoned (returning last) once every remaining start is past cutoff, the
+// earliest marker found so far by any other search.
+size_t first_marker_in(const char *data, const size_t first, const size_t last, const int n,
+                       const std::atomic<size_t> &cutoff) {
+    static constexpr int max_pairwise_window = 8;
+    static constexpr size_t block = 256;
+
+    if (n > max_pairwise_window) {
+        DistinctRun run;
+        for (size_t i = first; i < last + n - 1; i++) {
+            if (i % block == 0 && i >= cutoff.load(std::memory_order_relaxed) + n)
+                return last;
+            if (run.push(data[i]) >= (size_t)n)
+                return i + 1 - n;
+        }
+        return last;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)data;
+    std::array<unsigned char, block> repeated;
+    for (size_t start = first; start < last; start += block) {
+        if (start >= cutoff.load(std::memory_order_relaxed))
+            return last;
+
+        const size_t count = std::min(block, last - start);
+        std::fill(repeated.begin(), repeated.end(), 0);
+
+        for (int a = 0; a < n; a++)
+            for (int b = a + 1; b < n; b++) {
+                const unsigned char *pa = bytes + start + a, *pb = bytes + start + b;
+                for (size_t k = 0; k < count; k++)
+                    repeated[k] |= pa[k] == pb[k];
+            }
+
+        auto found = std::find(repeated.begin(), repeated.begin() + count, 0);
+        if (found != repeated.begin() + count)
+            return start + (found - repeated.begin());
+    }
+    return last;
 }
 
+// marker_start for large buffers: window starts are split into chunks,
+// each read with an overlap of n-1 characters, that are searched in
+// parallel.  The earliest hit so far is shared, so chunks that start after
+// it are skipped and chunks running past it are abandoned.
+std::optional<size_t> parallel_marker_start(const std::string &datapacket, int n) {
+    if (n <= 0 || datapacket.size() < (size_t)n)
+        return std::nullopt;
+
+    const size_t n_starts = datapacket.size() - n + 1;
+    const size_t n_chunks = std::max<size_t>(1, std::thread::hardware_concurrency()) * 4;
+    const size_t chunk_size = std::max<size_t>(1 << 16, (n_starts + n_chunks - 1) / n_chunks);
+
+    std::vector<size_t> chunk_starts((n_starts + chunk_size - 1) / chunk_size);
+    for (size_t i = 0; i < chunk_starts.size(); i++)
+        chunk_starts[i] = i * chunk_size;
+
+    std::atomic<size_t> best(n_starts);
+    std::for_each(std::execution::par, chunk_starts.begin(), chunk_starts.end(), [&](size_t start) {
+        const size_t last = std::min(n_starts, start + chunk_size);
+        const size_t found = first_marker_in(datapacket.data(), start, last, n, best);
+        if (found == last)
+            return;
+
+        size_t current = best.load();
+        while (found < current && !best.compare_exchange_weak(current, found))
+            ;
+    });
+
+    const size_t first = best.load();
+    if (first == n_starts)
+        return std::nullopt;
+    return first + n;
+}
+
+class MarkerDetector {
+    // finds every marker of each window size in a stream fed in blocks of any
+    // size, sharing one DistinctRun between all the sizes, so windows may
+    // span blocks.  Line breaks are not part of the stream.
+    std::vector<int> window_sizes;
+    DistinctRun run;
+
+public:
+    MarkerDetector(std::vector<int> sizes) : window_sizes(sizes) {
+        if (std::any_of(window_sizes.begin(), window_sizes.end(), [](int n) { return n <= 0; }))
+            throw std::invalid_argument("Window sizes must be positive");
+        std::sort(window_sizes.begin(), window_sizes.end());
+    }
+
+    // calls found(window_size, offset) with the offset just past each marker ending in this block
+    template <typename Callback>
+    void feed(const char *data, const size_t length, Callback found) {
+        for (size_t i = 0; i < length; i++) {
+            const unsigned char c = data[i];
+            if (c == '\n' || c == '\r')
+                continue;
+
+            const size_t run_length = run.push(c);
+            for (size_t j = 0; j < window_sizes.size() && (size_t)window_sizes[j] <= run_length; j++)
+                found(window_sizes[j], run.get_position());
+        }
+    }
+};
+
 std::string get_inputs(std::ifstream &input) {
-    std::vector<std::string> input_lines;
     std::string line;
+    std::getline(input, line);
+    return line;
+}
 
-    while (std::getline(input, line)) {
-        input_lines.push_back(line);
-    }
+// reports every marker for each window size, reading input in fixed-size blocks
+void stream_markers(std::istream &input, const std::vector<int> &window_sizes) {
+    MarkerDetector detector(window_sizes);
+    std::vector<char> block(1 << 16);
 
-    return input_lines[0];
+    while (input) {
+        input.read(block.data(), block.size());
+        detector.feed(block.data(), input.gcount(), [](int n, size_t offset) {
+            std::cout << n << " " << offset << "\n";
+        });
+    }
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    const std::string mode = argc > 2 ? argv[2] : "";
+    if (argc < 2 || (mode != "" && mode != "stream" && mode != "parallel") || (mode == "parallel" && argc != 3)) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [parallel | stream [window_size...]]" << std::endl;
+        std::cerr << "       input_file may be - for stdin when streaming" << std::endl;
         return 1;
     }
 
+    if (mode == "stream") {
+        std::vector<int> window_sizes;
+        for (int i = 3; i < argc; i++) {
+            window_sizes.push_back(std::stoi(argv[i]));
+            if (window_sizes.back() <= 0) {
+                std::cerr << "Window sizes must be positive: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        if (window_sizes.empty())
+            window_sizes = {4, 14};
+
+        if (std::string(argv[1]) == "-") {
+            stream_markers(std::cin, window_sizes);
+        } else {
+            std::ifstream input(argv[1], std::ios::binary);
+            if (!input.is_open()) {
+                std::cerr << "Could not open input file " << argv[1] << std::endl;
+                return 2;
+            }
+            stream_markers(input, window_sizes);
+        }
+
+        return 0;
+    }
+
     std::ifstream input(argv[1]);
     if (!input.is_open()) {
         std::cerr << "Could not open input file " << argv[1] << std::endl;
@@ -57,10 +232,21 @@ int main(int argc, char** argv) {
     }
 
     auto inputs = get_inputs(input);
+    auto starts = mode == "parallel" ? std::vector<std::optional<size_t>>{parallel_marker_start(inputs, 4),
+                                                                          parallel_marker_start(inputs, 14)}
+                                     : marker_starts(inputs, {4, 14});
+
+    // -1 where there is no marker
+    auto print = [](const std::optional<size_t> &start) {
+        if (start)
+            std::cout << *start << std::endl;
+        else
+            std::cout << -1 << std::endl;
+    };
 
     std::cout << "Part 1" << std::endl;
-    std::cout << marker_start(inputs, 4) << std::endl;
+    print(starts[0]);
 
     std::cout << "Part 2" << std::endl;
-    std::cout << marker_start(inputs, 14) << std::endl;
-}    
\ No newline at end of file
+    print(starts[1]);
+}
\ No newline at end of file
@@ -3,256 +3,324 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <numeric>
-#include <cassert>
+#include <iterator>
+#include <utility>
+#include <execution>
+#include <cstdint>
+#include <charconv>
+#include <stdexcept>
+#include <cctype>
+
+class NameTable {
+    // interns file and directory names, so each distinct name is stored once
+    private:
+        std::unordered_map<std::string, int> ids;
+        std::vector<std::string> names;
 
-#include "range/v3/all.hpp"
-namespace rv = ranges::views;
+    public:
+        int id(const std::string &name) {
+            auto [it, inserted] = ids.try_emplace(name, names.size());
+            if (inserted)
+                names.push_back(name);
+            return it->second;
+        }
 
-class File {
-        std::string name;
-        size_t size;
+        const std::string &name(int id) const {
+            return names[id];
+        }
+};
 
+class DirectoryTree {
+    // directories as a flat vector of nodes referring to each other by index,
+    // with the root at index 0.  Each directory's total size is kept current
+    // by adding a new file's size to every directory on its path, O(depth),
+    // so sizes can be queried at any point in a transcript.  With deferred
+    // sizes only each directory's own files are totalled as they are added,
+    // and the totals are filled in afterwards by calculate_sizes_parallel.
     public:
-        File(std::string name, size_t size) : name(name), size(size) {};
+        static const int root = 0;
+
+    private:
+        struct File {
+            int name;
+            size_t size;
+        };
+
+        struct Node {
+            int name;
+            int parent;
+            int depth;
+            std::vector<int> children;
+            std::vector<File> files;
+            size_t file_size = 0;
+            size_t size = 0;
+        };
 
-        std::string get_name() const {
-            return name;
+        NameTable names;
+        std::vector<Node> nodes;
+        bool deferred;
+
+        // (directory, name) -> child directory, and the set of (directory, name) files seen
+        std::unordered_map<std::uint64_t, int> child_index;
+        std::unordered_set<std::uint64_t> file_index;
+
+        static std::uint64_t key(int directory, int name) {
+            return ((std::uint64_t)directory << 32) | (std::uint32_t)name;
         }
 
-        size_t total_size() const {
-            return size;
+    public:
+        DirectoryTree(bool defer_sizes = false) : deferred(defer_sizes) {
+            nodes.push_back(Node{names.id("/"), -1, 0});
         }
 
-        friend std::ostream& operator<<(std::ostream& os, const File& file) {
-            os << " - " << file.name << " " << "(file, size=" << file.size << ")";
-            return os;
+        size_t size() const {
+            return nodes.size();
         }
-};
 
-class Directory {
-    private:
-        size_t size;
-        std::string name;
-        std::map<std::string, File> files;
-        std::map<std::string, Directory> directories;
-        bool size_needs_update;
-        Directory *parent;
+        int parent(int directory) const {
+            return nodes[directory].parent;
+        }
 
-    public:
-        Directory(std::string name, Directory *parent=nullptr) : name(name), size(0), parent(parent), size_needs_update(false) {};
-        size_t total_size() const;
-
-        std::string full_name() const {
-            std::vector<std::string> path;
-            const Directory *dir = this;
-            while (dir) {
-                path.push_back(dir->name);
-                dir = dir->parent;
-            }
+        std::string full_name(int directory) const {
+            std::vector<int> path;
+            for (int dir = directory; dir != -1; dir = nodes[dir].parent)
+                path.push_back(dir);
 
             std::reverse(path.begin(), path.end());
 
-            std::string result = path[0];
+            std::string result = names.name(nodes[path[0]].name);
             for (size_t i = 1; i < path.size()-1; i++) {
-                result += path[i] + "/";
+                result += names.name(nodes[path[i]].name) + "/";
             }
             if (path.size() > 1)
-                result += path[path.size()-1];
+                result += names.name(nodes[path.back()].name);
 
             return result;
         }
 
-        Directory *cd(std::string directory_name) {
-            if (directory_name == ".") {
-                return this;
-            }
+        // the named subdirectory, or directory itself if there is none;
+        // ".." at the root stays at the root
+        int cd(int directory, const std::string &directory_name) {
+            if (directory_name == ".")
+                return directory;
 
-            if (directory_name == "..") {
-                if (parent)
-                    return parent;
-                else
-                    return this;
-            }
+            if (directory_name == "..")
+                return directory == root ? root : nodes[directory].parent;
 
-            auto result = directories.find(directory_name);
-            if (result == directories.end())
-                return this;
+            auto result = child_index.find(key(directory, names.id(directory_name)));
+            if (result == child_index.end())
+                return directory;
 
-            return &result->second;
+            return result->second;
         }
 
-        void calculate_size() {
-            if (!size_needs_update) {
-                return;
-            }
-
-            size = 0;
-            for (auto&& [file_name, file] : files) {
-                size += file.total_size();
-            }
-
-            for (auto&& [dir_name, dir] : directories) {
-                size += dir.total_size();
+        void add_file(int directory, const std::string &file_name, size_t size) {
+            const int name = names.id(file_name);
+            if (file_index.insert(key(directory, name)).second) {
+                nodes[directory].files.push_back(File{name, size});
+                nodes[directory].file_size += size;
+                if (deferred)
+                    return;
+                for (int dir = directory; dir != -1; dir = nodes[dir].parent)
+                    nodes[dir].size += size;
             }
+        }
 
-            size_needs_update = false;
-        };
+        void add_dir(int directory, const std::string &directory_name) {
+            if (directory_name == "." || directory_name == "..")
+                return;
 
-        size_t total_size() { 
-            if (size_needs_update) {
-                calculate_size();
+            const int name = names.id(directory_name);
+            if (child_index.try_emplace(key(directory, name), (int)nodes.size()).second) {
+                nodes[directory].children.push_back(nodes.size());
+                nodes.push_back(Node{name, directory, nodes[directory].depth + 1});
             }
-            return size;
         }
 
-        void add_file(std::string file_name, size_t size) {
-            if (files.find(file_name) == files.end()) {
-                files.insert(std::make_pair(file_name, File(file_name, size)));
-                size_needs_update = true;
-            }
-        };
-
-        void add_dir(std::string directory_name) {
-            if (directory_name == ".") {
-                return;
-            }
+        size_t total_size(int directory) const {
+            return nodes[directory].size;
+        }
 
-            if (directory_name == "..") {
-                if (!parent) {
-                    parent = new Directory("parent");
-                    size_needs_update = true;
-                } 
-                return;
-            }
+        // total size of each directory, indexed by directory
+        std::vector<size_t> directory_sizes() const {
+            std::vector<size_t> result(nodes.size());
+            std::transform(nodes.begin(), nodes.end(), result.begin(), [](const Node &node) { return node.size; });
+            return result;
+        }
 
-            if (directories.find(directory_name) == directories.end()) {
-                directories.insert(std::make_pair(directory_name, Directory(directory_name, this)));
-                size_needs_update = true;
-                return;
-            }
-        };
+        // total size of each directory from the files alone, one depth level
+        // at a time from the deepest up; the directories on a level only read
+        // their children's totals, so each level is summed in parallel
+        void calculate_sizes_parallel() {
+            const int max_depth = std::transform_reduce(nodes.begin(), nodes.end(), 0,
+                                                        [](int a, int b) { return std::max(a, b); },
+                                                        [](const Node &node) { return node.depth; });
+
+            std::vector<std::vector<int>> levels(max_depth + 1);
+            for (size_t i = 0; i < nodes.size(); i++)
+                levels[nodes[i].depth].push_back(i);
+
+            std::for_each(levels.rbegin(), levels.rend(), [this](const std::vector<int> &level) {
+                std::for_each(std::execution::par, level.begin(), level.end(), [this](int i) {
+                    const auto &children = nodes[i].children;
+                    nodes[i].size = std::accumulate(children.begin(), children.end(), nodes[i].file_size,
+                                                    [this](size_t acc, int child) { return acc + nodes[child].size; });
+                });
+            });
+        }
 
-        std::string to_string(std::string prefix="") {
+        std::string to_string(int directory = root, std::string prefix = "") const {
             std::string sub_prefix = prefix + "  ";
             std::stringstream ss;
 
-            ss << prefix << "- " << name << " (dir)" << std::endl;
-            for (auto& file : files) 
-                ss << sub_prefix << file.second << std::endl;
+            const auto &node = nodes[directory];
+            ss << prefix << "- " << names.name(node.name) << " (dir)" << std::endl;
+            for (const auto &file : node.files)
+                ss << sub_prefix << " - " << names.name(file.name) << " (file, size=" << file.size << ")" << std::endl;
 
-            for (auto& directory : directories)
-                ss << directory.second.to_string(sub_prefix);
+            for (const int child : node.children)
+                ss << to_string(child, sub_prefix);
 
             return ss.str();
         }
-
-        std::vector<std::pair<std::string, std::size_t>> directory_sizes() {
-            std::vector<std::pair<std::string, std::size_t>> result;
-
-            result.push_back(std::make_pair(full_name(), total_size()));
-            for (auto&& [dir_name, dir]: directories) {
-                auto subdirs = dir.directory_sizes();
-                std::copy(subdirs.begin(), subdirs.end(), std::back_inserter(result));
-            }
-
-            return result;
-        }
 };
 
 class TraverseDirectoryTree {
+    // builds the tree from a terminal transcript one line at a time, so only
+    // the tree is kept in memory, never the transcript
     private:
-        Directory root;
-        Directory *cwd;
+        DirectoryTree tree;
+        int cwd;
+        bool listing;
 
     public:
-        Directory *get_root() {
-            return &root;
+        DirectoryTree &get_tree() {
+            return tree;
         }
 
-        TraverseDirectoryTree(std::vector<std::string> terminal) : root("/"), cwd(&root) {
-            size_t linenum = 0;
-            size_t n_lines = terminal.size();
-            while (linenum < n_lines) {
-                auto& command = terminal[linenum++];
+        TraverseDirectoryTree(bool defer_sizes = false) : tree(defer_sizes), cwd(DirectoryTree::root), listing(false) {}
+
+        void read(std::istream &terminal) {
+            std::string line;
+            while (std::getline(terminal, line))
+                feed(line);
+        }
 
-                assert(command.size() > 3);
-                assert(command[0] == '$');
+        void feed(std::string line) {
+            // drop trailing whitespace, including the \r of CRLF transcripts
+            line.erase(std::find_if(line.rbegin(), line.rend(), [](unsigned char c) { return !std::isspace(c); }).base(),
+                       line.end());
+            if (line.empty())
+                return;
 
-                std::stringstream ss(command.substr(2));
-                std::string command_name;
-                ss >> command_name;
+            if (line[0] == '$') {
+                listing = false;
 
-                if (command_name == "cd") {
-                    std::string directory_name;
-                    ss >> directory_name;
+                if (line.compare(0, 5, "$ cd ") == 0) {
+                    const std::string directory_name = line.substr(5);
 
                     if (directory_name == "/") {
-                        cwd = &root;
+                        cwd = DirectoryTree::root;
                     } else {
-                        cwd->add_dir(directory_name);
-                        cwd = cwd->cd(directory_name);
-                    }
-                } else if (command_name == "ls") {
-                    while (linenum < n_lines && terminal[linenum][0] != '$') {
-                        std::stringstream ss(terminal[linenum++]);
-                        std::string descriptor;
-                        std::string file_name;
-
-                        ss >> descriptor >> file_name;
-
-                        if (descriptor == "dir") {
-                            cwd->add_dir(file_name);
-                        } else {
-                            size_t size = std::stoi(descriptor);
-                            cwd->add_file(file_name, size);
-                        }
+                        tree.add_dir(cwd, directory_name);
+                        cwd = tree.cd(cwd, directory_name);
                     }
+                } else if (line.compare(0, 4, "$ ls") == 0) {
+                    listing = true;
                 }
+                return;
+            }
+
+            if (!listing)
+                throw std::invalid_argument("Output outside of ls: " + line);
+
+            const size_t space = line.find(' ');
+            if (space == std::string::npos)
+                throw std::invalid_argument("Invalid ls output: " + line);
+
+            const std::string file_name = line.substr(space + 1);
+            if (line.compare(0, space, "dir") == 0) {
+                tree.add_dir(cwd, file_name);
+            } else {
+                size_t size = 0;
+                auto [end, error] = std::from_chars(line.data(), line.data() + space, size);
+                if (error != std::errc() || end != line.data() + space)
+                    throw std::invalid_argument("Invalid ls output: " + line);
+
+                tree.add_file(cwd, file_name, size);
             }
         }
 };
 
-std::vector<std::string> get_inputs(std::ifstream &input) {
-    std::vector<std::string> input_lines;
-    std::string line;
+class SizeIndex {
+    // directory sizes in ascending order with running totals, for
+    // O(log n) threshold queries without touching path names
+    private:
+        std::vector<std::pair<size_t, int>> by_size;
+        std::vector<size_t> cumulative;
 
-    while (std::getline(input, line)) {
-        input_lines.push_back(line);
-    }
+        size_t count_below(size_t threshold) const {
+            return std::lower_bound(by_size.begin(), by_size.end(), std::make_pair(threshold, -1)) - by_size.begin();
+        }
 
-    return input_lines;
-}
+    public:
+        SizeIndex(const std::vector<size_t> &sizes) {
+            for (size_t i = 0; i < sizes.size(); i++)
+                by_size.push_back(std::make_pair(sizes[i], (int)i));
+            std::sort(by_size.begin(), by_size.end());
+
+            std::transform_inclusive_scan(by_size.begin(), by_size.end(), std::back_inserter(cumulative),
+                                          std::plus<size_t>(), [](const auto &p) { return p.first; });
+        }
+
+        // total size of the directories smaller than threshold
+        size_t total_below(size_t threshold) const {
+            const size_t n = count_below(threshold);
+            return n == 0 ? 0 : cumulative[n - 1];
+        }
+
+        // number of directories at least threshold in size
+        size_t count_at_least(size_t threshold) const {
+            return by_size.size() - count_below(threshold);
+        }
+
+        // the smallest directory at least threshold in size, or -1 if there is none
+        int smallest_at_least(size_t threshold) const {
+            const size_t n = count_below(threshold);
+            return n < by_size.size() ? by_size[n].second : -1;
+        }
+};
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    if (argc < 2 || argc > 3 || (argc == 3 && std::string(argv[2]) != "parallel")) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [parallel]" << std::endl;
+        std::cerr << "       input_file may be - for stdin" << std::endl;
         return 1;
     }
 
-    std::ifstream input(argv[1]);
-    if (!input.is_open()) {
-        std::cerr << "Could not open input file " << argv[1] << std::endl;
-        return 2;
-    }
-
-    auto inputs = get_inputs(input);
-    TraverseDirectoryTree tree(inputs);
-
-    auto sizes = tree.get_root()->directory_sizes();
+    const bool parallel = argc == 3;
 
-    auto small_dirs = sizes 
-                    | rv::filter([](auto& p) {
-                                    auto &&[dir_name, size] = p;
-                                    return size < 100000;
-                                 });
+    TraverseDirectoryTree traversal(parallel);
+    if (std::string(argv[1]) == "-") {
+        traversal.read(std::cin);
+    } else {
+        std::ifstream input(argv[1]);
+        if (!input.is_open()) {
+            std::cerr << "Could not open input file " << argv[1] << std::endl;
+            return 2;
+        }
+        traversal.read(input);
+    }
+    auto &tree = traversal.get_tree();
+    if (parallel)
+        tree.calculate_sizes_parallel();
 
-    auto total_small_dirs = std::accumulate(small_dirs.begin(), small_dirs.end(), 0, [](auto acc, auto& p) {
-        auto &&[dir_name, size] = p;
-        return acc + size;
-    });
+    const SizeIndex index(tree.directory_sizes());
+    auto total_small_dirs = index.total_below(100000);
 
     std::cout << "Part 1" << std::endl;
     std::cout << total_small_dirs << std::endl;
@@ -260,7 +328,7 @@ int main(int argc, char** argv) {
     std::cout << "Part 2" << std::endl;
 
     const size_t disk_space = 70000000;
-    const size_t used = tree.get_root()->total_size();
+    const size_t used = tree.total_size(DirectoryTree::root);
     const size_t available = disk_space - used;
 
     const size_t needed = 30000000;
@@ -273,22 +341,9 @@ int main(int argc, char** argv) {
 
     const size_t must_delete = needed - available;
 
-    std::sort(sizes.begin(), sizes.end(), [](auto& p1, auto& p2) {
-                                             auto &&[dir_name1, size1] = p1;
-                                             auto &&[dir_name2, size2] = p2;
-                                             return size1 < size2;
-                                           });
-    
-    auto big_enough = sizes 
-                    | rv::filter([must_delete](auto& p) {
-                                    auto &&[dir_name, size] = p;
-                                    return size >= must_delete;
-                                 })
-                    | rv::take(1);
-
-    for (auto& [dir_name, size] : big_enough) {
-        std::cout << dir_name << " " << size << std::endl; 
-    }
+    const int best = index.smallest_at_least(must_delete);
+    if (best >= 0)
+        std::cout << tree.full_name(best) << " " << tree.total_size(best) << std::endl;
 
-    return 0; 
-}    
\ No newline at end of file
+    return 0;
+}
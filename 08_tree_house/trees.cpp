@@ -2,105 +2,246 @@
 #include <fstream>
 #include <iostream>
 #include <string>
-#include "range/v3/all.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <execution>
+#include <utility>
+#include <stdexcept>
 
-namespace rv = ranges::views;
+struct Forest {
+    // tree heights in one contiguous row-major grid; a column is read by
+    // stepping through the grid cols at a time
+    using height = std::uint8_t;
 
-auto get_inputs(std::ifstream &input) {
-    std::vector<std::vector<int>> row_inputs;
-    std::vector<std::vector<int>> col_inputs;
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<height> heights;
+
+    size_t index(size_t row, size_t col) const {
+        return row * cols + col;
+    }
+};
+
+Forest get_inputs(std::ifstream &input) {
+    Forest forest;
     std::string line;
 
     while (std::getline(input, line)) {
-        std::vector<int> input_row;
-        int col = 0;
+        size_t col = 0;
         for (const auto& c : line) {
             if (c > '9' || c < '0') {
                 continue;
             }
-            int val = (int)(c - '0');
-            input_row.push_back(val);
-            if (col_inputs.size() > col) {
-                col_inputs[col].push_back(val);
-            } else {
-                col_inputs.push_back({val});
-            }
+            forest.heights.push_back(c - '0');
             col++;
         }
-        row_inputs.push_back(input_row);
+        if (col == 0)
+            continue;
+
+        if (forest.rows > 0 && col != forest.cols)
+            throw std::invalid_argument("Row " + std::to_string(forest.rows + 1) + " has " + std::to_string(col) +
+                                        " trees, expected " + std::to_string(forest.cols));
+
+        forest.cols = col;
+        forest.rows++;
     }
 
-    return std::make_pair(row_inputs, col_inputs);
+    return forest;
 }
 
-std::vector<bool> visibility_of_row(const std::vector<int> &row) {
-    std::vector<bool> visible_from_left;
-    std::vector<bool> visible_from_right_reversed;
+// marks the trees visible from the start of a line of length trees,
+// beginning at first and stepping step through the grid
+void mark_visible(const Forest &forest, size_t first, std::ptrdiff_t step, size_t length,
+                  std::vector<std::uint8_t> &visible) {
     int max_so_far = -1;
-
-    for (const auto height : row) {
-        visible_from_left.push_back(height > max_so_far);
+    for (size_t k = 0; k < length; k++) {
+        const size_t i = first + k * step;
+        const int height = forest.heights[i];
+        visible[i] |= height > max_so_far;
         max_so_far = std::max(max_so_far, height);
     }
+}
 
-    max_so_far = -1;
-    for (const auto height : row | rv::reverse) {
-        visible_from_right_reversed.push_back(height > max_so_far);
-        max_so_far = std::max(max_so_far, height);
+std::vector<std::uint8_t> visibility(const Forest &forest) {
+    std::vector<std::uint8_t> visible(forest.heights.size(), 0);
+    const std::ptrdiff_t cols = forest.cols;
+
+    for (size_t row = 0; row < forest.rows; row++) {
+        mark_visible(forest, forest.index(row, 0), 1, forest.cols, visible);
+        mark_visible(forest, forest.index(row, forest.cols-1), -1, forest.cols, visible);
+    }
+
+    for (size_t col = 0; col < forest.cols; col++) {
+        mark_visible(forest, forest.index(0, col), cols, forest.rows, visible);
+        mark_visible(forest, forest.index(forest.rows-1, col), -cols, forest.rows, visible);
+    }
+
+    return visible;
+}
+
+// calls seen(i, n) with the number of trees n seen looking back towards the
+// start of the line from each tree i along it.  The trees that could still
+// block a view are kept on a stack of strictly decreasing height; each tree
+// pops the shorter ones it hides and replaces one of equal height, so the
+// pass is O(length) and the stack never holds more than one tree per height.
+template <typename Callback>
+void n_seen_along(const Forest &forest, size_t first, std::ptrdiff_t step, size_t length, Callback seen) {
+    std::vector<size_t> blockers;
+
+    for (size_t k = 0; k < length; k++) {
+        const size_t i = first + k * step;
+        const auto height = forest.heights[i];
+
+        while (!blockers.empty() && forest.heights[first + blockers.back() * step] < height)
+            blockers.pop_back();
+
+        seen(i, (int)(k - (blockers.empty() ? 0 : blockers.back())));
+        if (!blockers.empty() && forest.heights[first + blockers.back() * step] == height)
+            blockers.pop_back();
+        blockers.push_back(k);
+    }
+}
+
+std::uint64_t max_scenic_score(const Forest &forest) {
+    const std::ptrdiff_t cols = forest.cols;
+
+    // product of the up and down viewing distances of each tree
+    std::vector<std::uint64_t> vertical(forest.heights.size(), 1);
+    auto multiply_vertical = [&vertical](size_t i, int n) { vertical[i] *= n; };
+    for (size_t col = 0; col < forest.cols; col++) {
+        n_seen_along(forest, forest.index(0, col), cols, forest.rows, multiply_vertical);
+        n_seen_along(forest, forest.index(forest.rows-1, col), -cols, forest.rows, multiply_vertical);
+    }
+
+    // the horizontal distances only need one row at a time
+    std::uint64_t best = 0;
+    std::vector<std::uint64_t> horizontal(forest.cols);
+    for (size_t row = 0; row < forest.rows; row++) {
+        const size_t first = forest.index(row, 0);
+        std::fill(horizontal.begin(), horizontal.end(), 1);
+        auto multiply_horizontal = [&horizontal, first](size_t i, int n) { horizontal[i - first] *= n; };
+
+        n_seen_along(forest, first, 1, forest.cols, multiply_horizontal);
+        n_seen_along(forest, forest.index(row, forest.cols-1), -1, forest.cols, multiply_horizontal);
+
+        for (size_t col = 0; col < forest.cols; col++)
+            best = std::max(best, horizontal[col] * vertical[first + col]);
     }
 
-    auto visible_from_right = visible_from_right_reversed | rv::reverse;
+    return best;
+}
+
+// Tiled versions for large grids.  Rows are handled in parallel; columns are
+// handled a tile of adjacent columns at a time, sweeping down (and up) the
+// grid so every step reads one short contiguous run of each row, with tiles
+// in parallel.  Each row or tile writes only its own trees, so no locking is
+// needed.
+const size_t tile_cols = 64;
+
+std::vector<size_t> indices(size_t n) {
+    std::vector<size_t> result(n);
+    std::iota(result.begin(), result.end(), 0);
+    return result;
+}
+
+std::vector<std::uint8_t> visibility_tiled(const Forest &forest) {
+    std::vector<std::uint8_t> visible(forest.heights.size(), 0);
 
-    auto visible = rv::zip(visible_from_left, visible_from_right) 
-                 | rv::transform([](auto &&t) {
-                                   auto &&[left, right] = t;
-                                   return left || right;
-                   }) 
-                 | ranges::to<std::vector<bool>>;
+    const auto rows = indices(forest.rows);
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&forest, &visible](size_t row) {
+        mark_visible(forest, forest.index(row, 0), 1, forest.cols, visible);
+        mark_visible(forest, forest.index(row, forest.cols-1), -1, forest.cols, visible);
+    });
+
+    const auto tiles = indices((forest.cols + tile_cols - 1) / tile_cols);
+    std::for_each(std::execution::par, tiles.begin(), tiles.end(), [&forest, &visible](size_t tile) {
+        const size_t first_col = tile * tile_cols;
+        const size_t width = std::min(tile_cols, forest.cols - first_col);
+        std::vector<int> max_so_far(width);
+
+        auto sweep = [&](size_t row) {
+            const size_t first = forest.index(row, first_col);
+            for (size_t c = 0; c < width; c++) {
+                const int height = forest.heights[first + c];
+                visible[first + c] |= height > max_so_far[c];
+                max_so_far[c] = std::max(max_so_far[c], height);
+            }
+        };
+
+        std::fill(max_so_far.begin(), max_so_far.end(), -1);
+        for (size_t row = 0; row < forest.rows; row++)
+            sweep(row);
+
+        std::fill(max_so_far.begin(), max_so_far.end(), -1);
+        for (size_t row = forest.rows; row-- > 0; )
+            sweep(row);
+    });
 
     return visible;
 }
 
-std::vector<int> n_seen_in_row(const std::vector<int> &row) {
-    const int n = row.size();
-    std::vector<int> init_most_recent(10, -1);
+std::uint64_t max_scenic_score_tiled(const Forest &forest) {
+    // product of the up and down viewing distances of each tree, with a
+    // strictly decreasing stack of (distance from the edge, height) per column
+    // of the tile, as in n_seen_along
+    std::vector<std::uint64_t> vertical(forest.heights.size(), 1);
 
-    auto most_recent = init_most_recent;
-    auto seen_to_left = [&most_recent](auto &&t) {
-        auto &&[i, height] = t;
-        int last = 0;
-        for (int h=height; h<10; h++) {
-            if (most_recent[h] == -1)
-                continue;
+    const auto tiles = indices((forest.cols + tile_cols - 1) / tile_cols);
+    std::for_each(std::execution::par, tiles.begin(), tiles.end(), [&forest, &vertical](size_t tile) {
+        const size_t first_col = tile * tile_cols;
+        const size_t width = std::min(tile_cols, forest.cols - first_col);
+        std::vector<std::vector<std::pair<size_t, Forest::height>>> blockers(width);
 
-            if (most_recent[h] > last)
-                last = most_recent[h];
-        } 
-        most_recent[height] = i;
-        return i - last;
-    };
-
-    auto n_seen_to_left = row 
-                          | rv::enumerate 
-                          | rv::transform(seen_to_left)
-                          | ranges::to<std::vector<int>>;
-    
-    most_recent = init_most_recent;
-    auto n_seen_to_right = rv::reverse(row)
-                           | rv::enumerate
-                           | rv::transform(seen_to_left)
-                           | ranges::to<std::vector<int>>;
-
-    auto n_seen_score = rv::zip(n_seen_to_left, rv::reverse(n_seen_to_right))
-                      | rv::transform([](auto &&t) { auto &&[left, right] = t; return left * right; })
-                      | ranges::to<std::vector<int>>;
-
-    return n_seen_score ;
+        // k counts rows from the edge the sweep starts at
+        auto sweep = [&](size_t row, size_t k) {
+            const size_t first = forest.index(row, first_col);
+            for (size_t c = 0; c < width; c++) {
+                const auto height = forest.heights[first + c];
+                auto &stack = blockers[c];
+
+                while (!stack.empty() && stack.back().second < height)
+                    stack.pop_back();
+
+                vertical[first + c] *= k - (stack.empty() ? 0 : stack.back().first);
+                if (!stack.empty() && stack.back().second == height)
+                    stack.pop_back();
+                stack.push_back(std::make_pair(k, height));
+            }
+        };
+
+        for (size_t row = 0; row < forest.rows; row++)
+            sweep(row, row);
+
+        for (auto &stack : blockers)
+            stack.clear();
+        for (size_t row = forest.rows; row-- > 0; )
+            sweep(row, forest.rows-1 - row);
+    });
+
+    // each row's best score, with the per-row maxima reduced in parallel
+    const auto rows = indices(forest.rows);
+    return std::transform_reduce(std::execution::par, rows.begin(), rows.end(), (std::uint64_t)0,
+                                 [](std::uint64_t a, std::uint64_t b) { return std::max(a, b); },
+                                 [&forest, &vertical](size_t row) {
+                                     const size_t first = forest.index(row, 0);
+                                     std::vector<std::uint64_t> horizontal(forest.cols, 1);
+                                     auto multiply_horizontal = [&horizontal, first](size_t i, int n) { horizontal[i - first] *= n; };
+
+                                     n_seen_along(forest, first, 1, forest.cols, multiply_horizontal);
+                                     n_seen_along(forest, forest.index(row, forest.cols-1), -1, forest.cols, multiply_horizontal);
+
+                                     std::uint64_t best = 0;
+                                     for (size_t col = 0; col < forest.cols; col++)
+                                         best = std::max(best, horizontal[col] * vertical[first + col]);
+                                     return best;
+                                 });
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    if (argc < 2 || argc > 3 || (argc == 3 && std::string(argv[2]) != "tiled")) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [tiled]" << std::endl;
         return 1;
     }
 
@@ -110,42 +251,17 @@ int main(int argc, char** argv) {
         return 2;
     }
 
-    auto &&[row_inputs, col_inputs] = get_inputs(input);
-    const size_t n = row_inputs.size();
-    const size_t m = col_inputs.size();
-
-    auto row_visibility = row_inputs | rv::transform(visibility_of_row) | rv::enumerate;
-    auto col_visibility = col_inputs | rv::transform(visibility_of_row) | rv::enumerate;
-
-    auto visibilities = rv::cartesian_product(row_visibility, col_visibility)
-                      | rv::transform([](auto &&t){
-                                         auto &&[rv, cv] = t;
-                                         auto &&[i, row] = rv;
-                                         auto &&[j, col] = cv;
-                                         return (row[j] || col[i]) ? 1 : 0;
-                                      })
-                      | ranges::to<std::vector<int>>;
+    const Forest forest = get_inputs(input);
+    const bool tiled = argc == 3;
 
-    auto n_visible = ranges::accumulate(visibilities, 0, std::plus<int>());
+    const auto visible = tiled ? visibility_tiled(forest) : visibility(forest);
+    auto n_visible = std::accumulate(visible.begin(), visible.end(), (size_t)0);
 
     std::cout << "Part 1: " << std::endl;
     std::cout << n_visible << std::endl;
 
-    auto row_seen_score = row_inputs | rv::transform(n_seen_in_row) | rv::enumerate;
-    auto col_seen_score = col_inputs | rv::transform(n_seen_in_row) | rv::enumerate;
-
-    auto seen_scores = rv::cartesian_product(row_seen_score, col_seen_score)
-                     | rv::transform([](auto &&t){
-                                         auto &&[rv, cv] = t;
-                                         auto &&[i, row] = rv;
-                                         auto &&[j, col] = cv;
-                                         return (row[j] * col[i]);
-                                      })
-                      | ranges::to<std::vector<int>>;
-
-    auto max_seen = ranges::accumulate(seen_scores, 0, ranges::max);
     std::cout << "Part 2: " << std::endl;
-    std::cout << max_seen << std::endl;
+    std::cout << (tiled ? max_scenic_score_tiled(forest) : max_scenic_score(forest)) << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}